@@ -30,6 +30,7 @@
  ***********************************************************************************************************/
 
 #include "TimedAutomata1.h"
+#include <avr/eeprom.h>
 
 SM* mySM = NULL;
 
@@ -39,11 +40,141 @@ SM* mySM = NULL;
 unsigned long TickTimer::tickTime;
 volatile unsigned char TickTimer::_tcnt_reload;
 volatile unsigned char TickTimer::_callback_array_head;
+volatile unsigned char TickTimer::_tick_counts = 0;
+volatile unsigned int TickTimer::_ticks_pending = 1;
+volatile boolean TickTimer::_tickless = false;
 
 uint8_t tccr2b_value;
 
+const uint16_t timer2Prescaler[8] = {0, 1, 8, 32, 64, 128, 256, 1024};   // Indexed by CS22:CS20
+#define TIMER2_COARSE_CS  ((1<<CS22) | (1<<CS21) | (1<<CS20))          // Prescalar = 1024 (idle intervals)
+
+static uint8_t coarseBlockTicks = 0;   // Ticks spanned by one block of coarse counts (0 = none)
+static uint16_t coarseBlockCounts = 0; // Coarse counts in one block
+
 callback arrCallback[MAX_CALLBACK];
 
+unsigned long TickTimer::_callback_cost_us = 0;
+volatile unsigned long TickTimer::_isr_max_us = 0;
+
+
+
+//====================================================================================
+// Admission control (internal)
+//
+// Each callback, SM::tick and State update may declare its worst-case cost (0 = 
+// undeclared, always admitted). The ISR costs the sum of callbacks and the tick of 
+// registered SM on every tick, and must fit in ISR_BUDGET_PERCENT of the tick time.
+// A state update runs in loop() and is preempted by the ISR. A resumable update runs in
+// slices, and between two slices loop() runs the rest of the program (loopCost of the SM).
+// Hence, its worst-case response time is the least fixed point of
+//		R = wcet + (slices - 1) * loopCost + ceil(R / tickTime) * isrCost
+// exec_time counts boundaries of SM ticks, the first of which may fall right after the
+// activation. Hence, R must be less than hardDeadline (converted to microseconds).
+// Declarations are checked when a state, SM or callback is added; changes made after that
+// (setWCET, setTickCost, setLoopCost, configure) are checked by Admission::check().
+
+uint8_t Admission::lastResult = ADMIT_OK;
+unsigned long Admission::lastDemand_us = 0;
+unsigned long Admission::lastBound_us = 0;
+State* Admission::lastState = NULL;
+
+static uint8_t admit(uint8_t result, unsigned long demand_us, unsigned long bound_us, State* s){
+  Admission::lastResult = result;
+  Admission::lastDemand_us = demand_us;
+  Admission::lastBound_us = bound_us;
+  Admission::lastState = s;
+  
+  #ifdef LOG_H
+    if      (result == ADMIT_ISR_BUDGET) {warn(W007);}
+    else if (result == ADMIT_DEADLINE || result == ADMIT_UNBOUNDED) {warn(W008);}
+  #endif
+  
+  return result;
+}
+
+static uint8_t checkState(SM* sm, State* s, unsigned long isrCost_us){
+  unsigned long T = TickTimer::tickTime;
+  
+  if (T == 0 || (*s).wcet_us == 0 || (*s).hardDeadline == (unsigned long)-1){
+    return admit(ADMIT_OK, (*s).wcet_us, (*s).hardDeadline, s);     // Nothing to analyse
+  }
+  
+  unsigned long period = T * (((*sm).tickTime > 0) ? (*sm).tickTime : 1);    // One exec_time count
+  if ((*s).hardDeadline > 0xFFFFFFFFUL / period){
+    return admit(ADMIT_OK, (*s).wcet_us, 0xFFFFFFFFUL, s);          // Deadline beyond range of microseconds
+  }
+  unsigned long D = (*s).hardDeadline * period;
+  
+  unsigned long C = (*s).wcet_us;                                   // Demand of loop() during activation
+  if ((*s).myResFcn != NULL && (*s).wcet_slices > 1){
+    if ((*sm).loopCost_us == 0) {return admit(ADMIT_UNBOUNDED, C, D, s);}
+    
+    unsigned long gaps = (*s).wcet_slices - 1;
+    if ((*sm).loopCost_us > (0xFFFFFFFFUL - C) / gaps) {return admit(ADMIT_DEADLINE, 0xFFFFFFFFUL, D, s);}   // Overflow
+    C += gaps * (*sm).loopCost_us;
+  }
+  if (C >= D) {return admit(ADMIT_DEADLINE, C, D, s);}
+  
+  unsigned long R = C;
+  while (true){
+    unsigned long n = R / T + ((R % T) ? 1 : 0);                    // ceil(R / T), without overflow
+    if (isrCost_us != 0 && n > (0xFFFFFFFFUL - C) / isrCost_us) {return admit(ADMIT_DEADLINE, 0xFFFFFFFFUL, D, s);}   // Overflow
+    
+    unsigned long Rn = C + n * isrCost_us;
+    if (Rn >= D) {return admit(ADMIT_DEADLINE, Rn, D, s);}
+    if (Rn == R) {return admit(ADMIT_OK, R, D, s);}
+    R = Rn;
+  }
+}
+
+static uint8_t checkMachine(SM* sm, unsigned long isrCost_us){
+  unsigned long budget = TickTimer::tickTime * ISR_BUDGET_PERCENT / 100;
+  
+  if (TickTimer::tickTime != 0 && isrCost_us > budget){
+    return admit(ADMIT_ISR_BUDGET, isrCost_us, budget, NULL);
+  }
+  
+  if (sm != NULL){
+    for (uint8_t i = 0; i < (*sm)._childState_head; i++){
+      if (checkState(sm, (*sm).childStates[i], isrCost_us) != ADMIT_OK) {return Admission::lastResult;}
+    }
+  }
+  
+  return admit(ADMIT_OK, isrCost_us, budget, NULL);
+}
+
+static unsigned long isrCost(){
+  return TickTimer::_callback_cost_us + ((mySM != NULL) ? (*mySM).tickCost_us : 0);
+}
+
+/******************************************************************
+Function: check (Admission)
+Parameters: None
+Returns:
+	ADMIT_OK, or the violation found (ADMIT_ISR_BUDGET, ADMIT_DEADLINE,
+	ADMIT_UNBOUNDED). Details are reported in Admission namespace.
+	
+Remarks: 
+	Re-runs the analysis of the ISR and of every state of the 
+	registered SM with the current declarations. Use it after a 
+	cost was declared or changed (State::setWCET, SM::setTickCost, 
+	SM::setLoopCost) or the TickTimer was configured once the 
+	states were added, as these are not checked by themselves.
+	Nothing is removed if a violation is found.
+
+Warning: (issued if <Log.h> is defined)
+	W007: If ISR cost exceeds the tick budget.
+	W008: If a state of registered SM misses its hard deadline.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+uint8_t Admission::check(){
+  return checkMachine(mySM, isrCost());
+}
+
 
 /******************************************************************
 Function: configure
@@ -117,6 +248,24 @@ void TickTimer::configure(unsigned long tickTime_us){
       #endif
       break;
   }
+  
+  _tick_counts = 256 - _tcnt_reload;   // Timer counts per tick (used to span several ticks in tickless mode)
+  
+  // Idle intervals of tickless mode run Timer2 at Prescalar = 1024. Find the smallest block of
+  // ticks that is an integral number of coarse counts, so that idle intervals do not drift.
+  coarseBlockTicks = 0;
+  coarseBlockCounts = 0;
+  
+  unsigned long tickCycles = (unsigned long)_tick_counts * timer2Prescaler[tccr2b_value & 0x07];
+  for (uint8_t n = 1; n <= 64 && tickTime != 0; n++){
+    if ((n * tickCycles) % 1024 == 0){
+      if (n * tickCycles / 1024 <= 256){
+        coarseBlockTicks = n;
+        coarseBlockCounts = n * tickCycles / 1024;
+      }
+      break;
+    }
+  }
 
 }
 
@@ -130,7 +279,9 @@ Parameters:
 Remarks: 
 	As there is limit on number of callbacks that can be registered, 
 	a warning will be issues (if enabled globally) in case the 
-	number exceeds the MAX_CALLBACK
+	number exceeds the MAX_CALLBACK.
+	The cost of callback is undeclared (refer registerCallback with 
+	wcet_us).
 
 Warning: (issued if <Log.h> is defined)
 	W002: If more than MAX_CALLBACK callbacks are attempted to register.
@@ -140,16 +291,55 @@ Error: (issued if <Log.h> is defined)
 
 ******************************************************************/
 void TickTimer::registerCallback(callback fcn){
+  registerCallback(fcn, 0);
+}
+
+/******************************************************************
+Function: registerCallback
+Parameters: 
+	1. fcn: type callback:: void (*fcn)(): Should be a function with
+		no input, no output arguments.
+	2. wcet_us: Worst-case execution time of fcn in microseconds.
+Returns:
+	ADMIT_OK, or the reason of rejection (ADMIT_FULL, ADMIT_ISR_BUDGET,
+	ADMIT_DEADLINE, ADMIT_UNBOUNDED). Details are reported in 
+	Admission namespace.
+
+Remarks: 
+	The callback is admitted only if the ISR still fits in its tick 
+	budget and every state of registered SM still meets its hard 
+	deadline. Configure the TickTimer before registering.
+	A callback of wcet_us = 0 adds no load and is always admitted
+	(if a slot is free), without analysing the registered SM. A 
+	violation already present is reported by Admission::check.
+
+Warning: (issued if <Log.h> is defined)
+	W002: If more than MAX_CALLBACK callbacks are attempted to register.
+	W007: If ISR cost would exceed the tick budget.
+	W008: If a state of registered SM would miss its hard deadline.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+uint8_t TickTimer::registerCallback(callback fcn, unsigned long wcet_us){
   if (_callback_array_head >= MAX_CALLBACK){
     // Ignore (Do not add callback. Issue warning)
     #ifdef LOG_H
         warn(W002);
     #endif
+    return admit(ADMIT_FULL, 0, 0, NULL);
   }
-  else{
-    arrCallback[TickTimer::_callback_array_head] = fcn;      // Add function pointer to list of callbacks
-    _callback_array_head++;                       // Increment head
+  
+  if (wcet_us != 0 && checkMachine(mySM, isrCost() + wcet_us) != ADMIT_OK){
+    return Admission::lastResult;                 // Rejected (Do not add callback)
   }
+  
+  arrCallback[TickTimer::_callback_array_head] = fcn;      // Add function pointer to list of callbacks
+  _callback_array_head++;                       // Increment head
+  _callback_cost_us += wcet_us;
+  
+  return admit(ADMIT_OK, isrCost(), TickTimer::tickTime * ISR_BUDGET_PERCENT / 100, NULL);
 }
 
 /******************************************************************
@@ -169,6 +359,7 @@ Error: (issued if <Log.h> is defined)
 void TickTimer::startTicking(){
   TCCR2B = tccr2b_value;               // Start the timer
   noInterrupts();                      // Disable interrupts
+  _ticks_pending = 1;                  // First interval is always a single tick
   TCNT2  = _tcnt_reload;               // Auto-Reload value
   TIMSK2 = (1<<TOIE2);                 // Enable OVF interrupt on Timer 2
   interrupts();                        // Enable interrupts
@@ -196,18 +387,145 @@ void TickTimer::stopTicking(){
 }
 
 
+/******************************************************************
+Function: enableTickless()
+Parameters: None
+
+Remarks: 
+	Enables tickless idle mode. Instead of interrupting on every 
+	tick, the timer is programmed to expire at the next tick at which
+	the registered SM needs attention (its next tickTime boundary, 
+	where transitions and state deadlines are evaluated). The elapsed
+	ticks are caught up in bulk on wake-up.
+	
+	Long idle intervals switch Timer2 to Prescalar = 1024 and span a 
+	whole number of blocks of ticks that are an integral number of 
+	coarse counts, hence no drift. The remainder is covered by short
+	intervals at the tick prescalar. As Timer2 is 8-bit, the longest
+	single interval (at 16 MHz) is 16 ms (refer longestInterval):
+	
+		tickTime      tick (*)   short interval   long interval
+		TICK_50US     50 us      10 ticks         320 ticks
+		TICK_100US    100 us     5 ticks          160 ticks
+		TICK_200US    200 us     2 ticks          80 ticks
+		TICK_500US    500 us     2 ticks          32 ticks
+		TICK_1MS      1 ms       1 tick           16 ticks
+		TICK_2MS      1 ms       2 ticks          16 ticks
+		TICK_4MS      2 ms       2 ticks          8 ticks
+	
+	(*) Tick as programmed by configure: 125 counts at Prescalar = 128
+	and 256 give 1 ms and 2 ms for TICK_2MS and TICK_4MS.
+	
+	An SM whose tickTime is below the short interval gains nothing.
+	Registered callbacks must run on every tick, hence the mode has
+	no effect while any callback is registered.
+	
+Warning: (issued if <Log.h> is defined)
+	None
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+void TickTimer::enableTickless(){
+  _tickless = true;                    // Takes effect from the next timer interrupt
+}
+
+/******************************************************************
+Function: disableTickless()
+Parameters: None
+
+Remarks: 
+	Disables tickless idle mode. Periodic ticking resumes from the 
+	next timer interrupt.
+	
+Warning: (issued if <Log.h> is defined)
+	None
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+void TickTimer::disableTickless(){
+  _tickless = false;
+}
+
+/******************************************************************
+Function: longestInterval()
+Parameters: None
+Returns:
+	Number of ticks spanned by the longest single timer interval in
+	tickless mode, for the configured tickTime (refer enableTickless).
+	
+Warning: (issued if <Log.h> is defined)
+	None
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+unsigned int TickTimer::longestInterval(){
+  if (_tick_counts == 0) {return 1;}
+  
+  unsigned int shortTicks = 256 / _tick_counts;
+  unsigned int longTicks = (coarseBlockTicks != 0) ? coarseBlockTicks * (256 / coarseBlockCounts) : 0;
+  
+  return (longTicks > shortTicks) ? longTicks : shortTicks;
+}
+
+// Programs Timer2 for the next interval and records the ticks it spans.
+static void programNextInterval(){
+  unsigned int ticks = 1;                                 // Periodic ticking
+  uint8_t prescalar = tccr2b_value;
+  uint16_t counts = TickTimer::_tick_counts;
+  
+  if (TickTimer::_tickless && TickTimer::_callback_array_head == 0 && TickTimer::_tick_counts != 0){
+    unsigned int maxTicks = 256 / TickTimer::_tick_counts;  // Longest interval at tick prescalar
+    unsigned long due = (mySM != NULL) ? (*mySM).ticksToNextEvent() : 0xFFFFFFFFUL;
+    
+    unsigned long blocks = 0;
+    if (coarseBlockTicks != 0){
+      blocks = due / coarseBlockTicks;
+      if (blocks > 256 / coarseBlockCounts) {blocks = 256 / coarseBlockCounts;}
+    }
+    
+    if (blocks * coarseBlockTicks > maxTicks){            // Long idle interval at coarse prescalar
+      ticks = blocks * coarseBlockTicks;
+      prescalar = TIMER2_COARSE_CS;
+      counts = blocks * coarseBlockCounts;
+    }
+    else{
+      ticks = (due < maxTicks) ? due : maxTicks;
+      counts = ticks * TickTimer::_tick_counts;
+    }
+  }
+  
+  TickTimer::_ticks_pending = ticks;
+  TCCR2B = prescalar;
+  TCNT2 = 256 - counts;                                   // == _tcnt_reload for a single tick
+}
 
 ISR(TIMER2_OVF_vect){
+  #ifdef TA_MEASURE_ISR
+    unsigned long isrStart = micros();
+  #endif
+  
+  unsigned int elapsed = TickTimer::_ticks_pending;        // Ticks spanned by the interval just expired
+  
   for (uint8_t i = 0; i < TickTimer::_callback_array_head; i++){    
     arrCallback[i]();
   }
   
   if (mySM != NULL) {
-	(*mySM).tick();
+	(*mySM).advance(elapsed);
   }
 	
-  TCNT2 = TickTimer::_tcnt_reload;
+  programNextInterval();
   
+  #ifdef TA_MEASURE_ISR
+    unsigned long isrTime = micros() - isrStart;
+    if (isrTime > TickTimer::_isr_max_us) {TickTimer::_isr_max_us = isrTime;}
+  #endif
 }
 
 
@@ -235,6 +553,10 @@ Error: (issued if <Log.h> is defined)
 ******************************************************************/
 State::State(updateFcn fcn){
   myFcn = fcn;
+  myResFcn = NULL;
+  _lc = 0;
+  wcet_us = 0;
+  wcet_slices = 1;
   
   inProgress = false;
   softDeadline = -1;
@@ -262,6 +584,10 @@ Error: (issued if <Log.h> is defined)
 ******************************************************************/
 State::State(updateFcn fcn, unsigned long hard_deadline_ticks){
   myFcn = fcn;
+  myResFcn = NULL;
+  _lc = 0;
+  wcet_us = 0;
+  wcet_slices = 1;
   
   inProgress = false;
   softDeadline = -1;
@@ -290,12 +616,139 @@ Error: (issued if <Log.h> is defined)
 ******************************************************************/
 State::State(updateFcn fcn, unsigned long hard_deadline_ticks, unsigned long soft_deadline_ticks){
   myFcn = fcn;
+  myResFcn = NULL;
+  _lc = 0;
+  wcet_us = 0;
+  wcet_slices = 1;
+  
+  inProgress = false;
+  softDeadline = soft_deadline_ticks;
+  hardDeadline = hard_deadline_ticks;
+}
+
+/******************************************************************
+Function: State (constructor)
+Parameters: 
+	1. fcn: type resumableFcn:: uint8_t (*fcn)(State*): Resumable 
+		update function written with TA_BEGIN/TA_YIELD/TA_END.
+
+Remarks: 
+	Constructs the State class object with a resumable update 
+	function. Defaults the softDeadline, and hardDeadlines to -1.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+State::State(resumableFcn fcn){
+  myFcn = NULL;
+  myResFcn = fcn;
+  _lc = 0;
+  wcet_us = 0;
+  wcet_slices = 1;
+  
+  inProgress = false;
+  softDeadline = -1;
+  hardDeadline = -1;
+}
+
+/******************************************************************
+Function: State (constructor)
+Parameters: 
+	1. fcn: type resumableFcn:: uint8_t (*fcn)(State*): Resumable 
+		update function written with TA_BEGIN/TA_YIELD/TA_END.
+	2. hard_deadline_ticks: Number of ticks beyond which state is 
+		not allowed to take for processing.
+
+Remarks: 
+	Constructs the State class object with a resumable update 
+	function. Defaults the softDeadline to -1.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+State::State(resumableFcn fcn, unsigned long hard_deadline_ticks){
+  myFcn = NULL;
+  myResFcn = fcn;
+  _lc = 0;
+  wcet_us = 0;
+  wcet_slices = 1;
+  
+  inProgress = false;
+  softDeadline = -1;
+  hardDeadline = hard_deadline_ticks;
+}
+
+/******************************************************************
+Function: State (constructor)
+Parameters: 
+	1. fcn: type resumableFcn:: uint8_t (*fcn)(State*): Resumable 
+		update function written with TA_BEGIN/TA_YIELD/TA_END.
+	2. hard_deadline_ticks: Number of ticks beyond which state is 
+		not allowed to take for processing.
+	3. soft_deadline_ticks: Number of ticks beyond which state is 
+		not allowed to take for processing.
+
+Remarks: 
+	Constructs the State class object with a resumable update 
+	function.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+State::State(resumableFcn fcn, unsigned long hard_deadline_ticks, unsigned long soft_deadline_ticks){
+  myFcn = NULL;
+  myResFcn = fcn;
+  _lc = 0;
+  wcet_us = 0;
+  wcet_slices = 1;
   
   inProgress = false;
   softDeadline = soft_deadline_ticks;
   hardDeadline = hard_deadline_ticks;
 }
 
+/******************************************************************
+Function: update (State)
+Parameters: None
+Returns:
+	true:  If the update function has run to completion.
+	false: If a resumable update function yielded (TA_YIELD) and 
+		must be resumed by a later call.
+	
+Remarks: 
+	Executes the update function if state is in progress. A plain 
+	updateFcn always runs to completion in one call, while a 
+	resumableFcn runs only up to its next TA_YIELD. 
+	Internal Function. DO NOT EXPLICITLY CALL.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+boolean State::update(){
+  if (!inProgress)      {return true;}
+  
+  if (myResFcn != NULL) {return (myResFcn(this) == TA_DONE);}
+  
+  myFcn();
+  return true;
+}
+
 /******************************************************************
 Function: tick (State)
 Parameters: None
@@ -338,6 +791,8 @@ Parameters:
 		and return a state(presumed next state). The inputs
 		to SM are assumed to be either declared as static in 
 		gnv implementation by user OR declared globally. 
+		Alternatively, the inputs can be declared with addInput and
+		read with readInput in gnv; see addInput.
 	2. interval: Number of time steps (ticks) of TickTimer after 
 		which the SM should check for transitions.
 
@@ -357,31 +812,64 @@ Error: (issued if <Log.h> is defined)
 SM::SM(transitionFcn gnv, unsigned long interval){
   getNextValues = gnv;
   tickTime = interval;
+  tickCount = 0;
+  tickCost_us = 0;
+  loopCost_us = 0;
+  
+  _childState_head = 0;
+  currState = NULL;
+  isTrnActive = false;
+  
+  _input_head = 0;
+  _input_bytes = 0;
+  _snapFront = 0;
+  
+  _memoFrom = NULL;
+  _memoNext = NULL;
+  _memoValid = false;
+  memoEvals = 0;
+  memoHits = 0;
 }
 
 /******************************************************************
 Function: registerToTimer (SM)
 Parameters: None
+Returns:
+	ADMIT_OK, or the reason of rejection (ADMIT_ISR_BUDGET, 
+	ADMIT_DEADLINE, ADMIT_UNBOUNDED). Details are reported in 
+	Admission namespace.
 	
 Remarks: 
 	Registers the SM::tick to TickTimer as callback. Hence, tick of
 	this SM object will be executed every time TickTimer ticks.
+	The SM is registered only if the ISR, with tickCost_us of this 
+	SM, fits in its tick budget and every state of this SM meets its
+	hard deadline. All states are checked again here, hence costs 
+	changed after addState, or a TickTimer configured after it, are 
+	covered if this is called last (else use Admission::check).
 
 Warning: (issued if <Log.h> is defined)
 	W003: If mySM is not NULL, the primary SM for program is 
 		overwritten and the warning is issued to indicate this.
+	W007: If ISR cost would exceed the tick budget.
+	W008: If a state of this SM would miss its hard deadline.
 
 Error: (issued if <Log.h> is defined)
 	None.
 
 ******************************************************************/
-void SM::registerToTimer(){
+uint8_t SM::registerToTimer(){
+	if (checkMachine(this, TickTimer::_callback_cost_us + tickCost_us) != ADMIT_OK) {
+		return Admission::lastResult;
+	}
+	
 	if (mySM != NULL) {
 		#ifdef LOG_H
                   warn(W003);
                 #endif
 	}
 	mySM = this;
+	return ADMIT_OK;
 }
 
 /******************************************************************
@@ -389,28 +877,48 @@ Function: addState (SM)
 Parameters: 
 	1. s: State object to be added to list of children.
 	
+Returns:
+	ADMIT_OK, or the reason of rejection (ADMIT_FULL, ADMIT_DEADLINE,
+	ADMIT_UNBOUNDED).
+	Details are reported in Admission namespace.
+	
 Remarks: 
-	Adds new state object to SM.
+	Adds new state object to SM. If the state declares its wcet_us 
+	(State::setWCET) and a hard deadline, it is added only if its 
+	worst-case response time under the current ISR load meets the 
+	deadline. For resumable states, declare the cost and number of 
+	slices (State::setWCET(us, slices)) and the cost of loop() between
+	two steps of this SM (SM::setLoopCost), which delays each slice.
+	Declare these and configure the TickTimer before adding the state:
+	later changes are not checked till SM::registerToTimer or 
+	Admission::check.
 
 Warning: (issued if <Log.h> is defined)
 	W004: If the maximum number of children possible (MAX_CHILD_STATE)
 		are already registered. In this case, the new state addition is
 		ignored.
+	W008: If the state would miss its hard deadline, or its bound 
+		cannot be computed (ADMIT_UNBOUNDED).
 
 Error: (issued if <Log.h> is defined)
 	None.
 
 ******************************************************************/
-void SM::addState(State* s){
+uint8_t SM::addState(State* s){
   if (_childState_head >= MAX_CHILD_STATE){
     #ifdef LOG_H
         warn(W004);
     #endif
+    return admit(ADMIT_FULL, 0, 0, s);
   }
-  else{
-    childStates[_childState_head] = s;
-    _childState_head++;
+  
+  if (checkState(this, s, TickTimer::_callback_cost_us + tickCost_us) != ADMIT_OK){   // ISR load with this SM registered
+    return Admission::lastResult;
   }
+  
+  childStates[_childState_head] = s;
+  _childState_head++;
+  return ADMIT_OK;
 }
 
 /******************************************************************
@@ -427,7 +935,7 @@ Algorithm:
 	2.		If current state has done its job?
 	3.			If not, tick it (current state). 
 	4. 				Raise any warning/errors.
-	5.			If yes, check enable the transition and get out.
+	5.			If yes, enable the transition and get out.
 
 Warning: (issued if <Log.h> is defined)
 	W005: If state hits the soft-deadline.
@@ -471,6 +979,56 @@ void SM::tick(){
   return; // 0;
 }
 
+/******************************************************************
+Function: advance (SM)
+Parameters: 
+	1. ticks: Number of TickTimer ticks elapsed since the last call.
+	
+Remarks: 
+	Internal Function... DO NOT EXPLICITLY CALL.
+	Catches up the tickCount in bulk and ticks the SM. In tickless 
+	mode the timer never skips past a tickTime boundary of the SM 
+	(see ticksToNextEvent), hence the exec_time of running state is 
+	advanced by tick() exactly as in periodic mode.
+	
+Warning: (issued if <Log.h> is defined)
+	Same as tick (SM).
+
+Error: (issued if <Log.h> is defined)
+	Same as tick (SM).
+
+******************************************************************/
+void SM::advance(unsigned long ticks){
+  if (ticks > 1){
+    tickCount += ticks - 1;                 // Skipped ticks: nothing was due
+  }
+  tick();
+}
+
+/******************************************************************
+Function: ticksToNextEvent (SM)
+Parameters: None
+Returns:
+	Number of ticks (>= 1) until the SM reaches its next tickTime 
+	boundary, at which a transition or a state deadline is evaluated.
+	
+Remarks: 
+	Internal Function... Used by TickTimer in tickless mode.
+	
+Warning: (issued if <Log.h> is defined)
+	None
+
+Error: (issued if <Log.h> is defined)
+	None
+
+******************************************************************/
+unsigned long SM::ticksToNextEvent(){
+  if (tickCount >= tickTime){
+    return 1;
+  }
+  return tickTime - tickCount;
+}
+
 /******************************************************************
 Function: reset (SM)
 Parameters: None
@@ -497,7 +1055,10 @@ Parameters: None
 	
 Remarks: 
 	Executes the state and computes the next state if transition is 
-	enabled.
+	enabled. A resumable state executes only one slice per call; the 
+	transition is taken on the call in which its update completes.
+	Hence, several machines stepped from loop() interleave, and the 
+	exec_time of the state counts the ticks across all its slices.
 	
 Warning: (issued if <Log.h> is defined)
 	None
@@ -509,14 +1070,512 @@ Error: (issued if <Log.h> is defined)
 void SM::step(){
   if (isTrnActive == true){
     
-    //is resetting here required?
-    currState->inProgress = true;
-    currState->update();
+    if (currState->inProgress == false){     // New activation of state: restart the run time
+      currState->exec_time = 0;
+      currState->inProgress = true;
+    }
+    
+    if (currState->update() == false){       // Yielded: resume on next step()
+      return;
+    }
     currState->inProgress = false;
     
-    currState = getNextValues(currState);    
+    noInterrupts();
+    latch();                                 // Inputs as left by the update, stable while gnv runs
+    interrupts();
+    currState = nextState();    
     isTrnActive = false;
   }
 }
 
+/******************************************************************
+Function: addInput (SM)
+Parameters: 
+	1. src: Address of the (global or static) input variable.
+	2. size: Size of input in bytes, e.g. sizeof(var).
+	
+Remarks: 
+	Declares an input of the transition function. The declared inputs
+	are latched into a snapshot by step() right before the transition
+	is evaluated (after the update of the state, which may write them),
+	so that gnv reads consistent values even if the variables change 
+	while it runs. gnv copies them out with readInput(i, &var), where
+	i is the order of declaration and var has the declared size, e.g.
+		int v; sm.readInput(0, &v);
+	If any input is declared, gnv is assumed to depend only on the 
+	current state and the declared inputs. When both are unchanged 
+	since the last transition, step() reuses the previous next state 
+	instead of calling gnv. Hit rate = memoHits / memoEvals.
+
+Warning: (issued if <Log.h> is defined)
+	W009: If more than MAX_SM_INPUTS inputs or MAX_INPUT_BYTES bytes
+		are declared. The input is ignored.
+
+Error: (issued if <Log.h> is defined)
+	None
+
+******************************************************************/
+void SM::addInput(const volatile void* src, uint8_t size){
+  if (_input_head >= MAX_SM_INPUTS || _input_bytes + size > MAX_INPUT_BYTES){
+    #ifdef LOG_H
+        warn(W009);
+    #endif
+    return;
+  }
+  
+  noInterrupts();
+  _inputs[_input_head] = src;
+  _inputSize[_input_head] = size;
+  _inputOffset[_input_head] = _input_bytes;
+  _input_head++;
+  _input_bytes += size;
+  _memoValid = false;                       // Cached transition did not depend on the new input
+  interrupts();
+}
+
+/******************************************************************
+Function: latch (SM)
+Parameters: None
+	
+Remarks: 
+	Internal Function... DO NOT EXPLICITLY CALL.
+	Copies the declared inputs into the back buffer of the snapshot 
+	and makes it the front buffer. The previous snapshot is kept in 
+	the back buffer for comparison by nextState.
+	
+Warning: (issued if <Log.h> is defined)
+	None
+
+Error: (issued if <Log.h> is defined)
+	None
+
+******************************************************************/
+void SM::latch(){
+  uint8_t* dst = _snapshot[_snapFront ^ 1];
+  
+  for (uint8_t i = 0; i < _input_head; i++){
+    const volatile uint8_t* src = (const volatile uint8_t*)_inputs[i];
+    for (uint8_t j = 0; j < _inputSize[i]; j++){
+      *dst++ = src[j];
+    }
+  }
+  
+  _snapFront ^= 1;
+}
+
+/******************************************************************
+Function: nextState (SM)
+Parameters: None
+Returns:
+	Next state of machine from currState.
+	
+Remarks: 
+	Internal Function... DO NOT EXPLICITLY CALL.
+	Calls gnv, unless inputs are declared and neither currState nor 
+	the snapshot changed since the last evaluation, in which case the
+	cached next state is returned.
+	
+Warning: (issued if <Log.h> is defined)
+	None
+
+Error: (issued if <Log.h> is defined)
+	None
+
+******************************************************************/
+State* SM::nextState(){
+  if (_input_head == 0){
+    return getNextValues(currState);        // Inputs unknown: always evaluate
+  }
+  
+  memoEvals++;
+  
+  if (_memoValid && _memoFrom == currState && 
+      memcmp(_snapshot[_snapFront], _snapshot[_snapFront ^ 1], _input_bytes) == 0){
+    memoHits++;
+    return _memoNext;
+  }
+  
+  _memoFrom = currState;
+  _memoNext = getNextValues(currState);
+  _memoValid = true;
+  return _memoNext;
+}
+
+
+
+//====================================================================================
+// Checkpoint Implementation
+//
+// Storage holds two slots of Checkpoint::size() bytes each, from base. save() always writes
+// the slot not holding the newest valid image, so a brownout during a save leaves the 
+// previous image intact. restore() applies the valid image with the newer sequence number.
+//
+// Image layout (multi-byte fields are little endian):
+//	'T', 'A', CHECKPOINT_VERSION, sequence number (2), number of machines
+//	per machine:	number of child states, index of currState (0xFF = NULL), 
+//					flags (bit0: isTrnActive, bit1: currState in progress), tickCount (4)
+//					exec_time of each child state (4 each)
+//	CRC-16/CCITT of all preceding bytes (2)
+
+#define CKPT_NO_STATE     0xFF
+#define CKPT_TRN_ACTIVE   0x01
+#define CKPT_IN_PROGRESS  0x02
+#define CKPT_NO_SLOT      -1
+
+// Decoded runtime state of one machine (restore).
+struct CheckpointSM{
+  uint8_t idx, flags;
+  unsigned long tickCount;
+  unsigned long exec_time[MAX_CHILD_STATE];
+};
+
+SM* arrCheckpointSM[MAX_CHECKPOINT_SM];
+uint8_t checkpointSM_head = 0;
+
+storageReadFcn ckptRead = NULL;
+storageWriteFcn ckptWrite = NULL;
+uint16_t ckptBase = 0;
+
+boolean ckptSlotKnown = false;         // true, if ckptSlot/ckptSeq reflect the storage
+int8_t ckptSlot = CKPT_NO_SLOT;        // slot holding the newest valid image
+uint16_t ckptSeq = 0;                  // sequence number of that image
+
+uint16_t ckptAddr, ckptCrc, ckptWritten;
+boolean ckptIncremental;
+
+
+static uint16_t crc16Update(uint16_t crc, uint8_t b){
+  crc ^= (uint16_t)b << 8;
+  for (uint8_t i = 0; i < 8; i++){
+    crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+  }
+  return crc;
+}
+
+static void putByte(uint8_t b){
+  ckptCrc = crc16Update(ckptCrc, b);
+  if (!ckptIncremental || ckptRead(ckptAddr) != b){        // Incremental: skip unchanged bytes
+    ckptWrite(ckptAddr, b);
+    ckptWritten++;
+  }
+  ckptAddr++;
+}
+
+static void putLong(unsigned long v){
+  for (uint8_t i = 0; i < 4; i++){
+    putByte((uint8_t)(v >> (8 * i)));
+  }
+}
+
+static uint8_t getByte(){
+  uint8_t b = ckptRead(ckptAddr++);
+  ckptCrc = crc16Update(ckptCrc, b);
+  return b;
+}
+
+static unsigned long getLong(){
+  unsigned long v = 0;
+  for (uint8_t i = 0; i < 4; i++){
+    v |= (unsigned long)getByte() << (8 * i);
+  }
+  return v;
+}
+
+static uint16_t slotAddress(uint8_t slot){
+  return ckptBase + slot * Checkpoint::size();
+}
+
+// Reads the image in slot. Returns true, if it is valid for the registered machines.
+// Decodes its fields into image (if not NULL). Interrupts stay enabled.
+static boolean readSlot(uint8_t slot, uint16_t* seq, CheckpointSM* image){
+  ckptAddr = slotAddress(slot);
+  ckptCrc = 0xFFFF;
+  
+  if (getByte() != 'T' || getByte() != 'A')      {return false;}
+  if (getByte() != CHECKPOINT_VERSION)           {return false;}
+  *seq = getByte();
+  *seq |= (uint16_t)getByte() << 8;
+  if (getByte() != checkpointSM_head)            {return false;}
+  
+  for (uint8_t i = 0; i < checkpointSM_head; i++){
+    CheckpointSM m;
+    
+    uint8_t nChild = getByte();
+    m.idx = getByte();
+    if (nChild != (*arrCheckpointSM[i])._childState_head)   {return false;}
+    if (m.idx != CKPT_NO_STATE && m.idx >= nChild)          {return false;}
+    
+    m.flags = getByte();
+    m.tickCount = getLong();
+    for (uint8_t j = 0; j < nChild; j++) {m.exec_time[j] = getLong();}
+    
+    if (image != NULL) {image[i] = m;}
+  }
+  
+  uint16_t crc = ckptCrc;
+  uint16_t stored = ckptRead(ckptAddr) | ((uint16_t)ckptRead(ckptAddr + 1) << 8);
+  return (crc == stored);
+}
+
+// Finds the slot holding the newest valid image (CKPT_NO_SLOT, if none).
+static void findNewestSlot(){
+  uint16_t seq[2];
+  boolean valid[2];
+  
+  valid[0] = readSlot(0, &seq[0], NULL);
+  valid[1] = readSlot(1, &seq[1], NULL);
+  
+  if (valid[0] && valid[1]) {ckptSlot = ((int16_t)(seq[1] - seq[0]) > 0) ? 1 : 0;}
+  else if (valid[0])        {ckptSlot = 0;}
+  else if (valid[1])        {ckptSlot = 1;}
+  else                      {ckptSlot = CKPT_NO_SLOT;}
+  
+  ckptSeq = (ckptSlot == CKPT_NO_SLOT) ? 0 : seq[ckptSlot];
+  ckptSlotKnown = true;
+}
+
+static uint8_t eepromRead(uint16_t addr){
+  return eeprom_read_byte((const uint8_t*)(uintptr_t)addr);
+}
+
+static void eepromWrite(uint16_t addr, uint8_t value){
+  eeprom_write_byte((uint8_t*)(uintptr_t)addr, value);        // Unconditional: comparing is left to incremental mode
+}
+
+/******************************************************************
+Function: registerMachine (Checkpoint)
+Parameters: 
+	1. sm: SM object whose runtime state is to be checkpointed.
+
+Remarks: 
+	Machines are stored in the image in order of registration, and 
+	their states in order of SM::addState. The same order must be 
+	used on restore, otherwise the image is rejected.
+
+Warning: (issued if <Log.h> is defined)
+	W006: If more than MAX_CHECKPOINT_SM machines are attempted to 
+		register. The machine is ignored.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+void Checkpoint::registerMachine(SM* sm){
+  if (checkpointSM_head >= MAX_CHECKPOINT_SM){
+    #ifdef LOG_H
+        warn(W006);
+    #endif
+  }
+  else{
+    arrCheckpointSM[checkpointSM_head] = sm;
+    checkpointSM_head++;
+    ckptSlotKnown = false;             // Layout of slots changed
+  }
+}
+
+/******************************************************************
+Function: setStorage (Checkpoint)
+Parameters: 
+	1. rd: Function reading a byte at given address of storage.
+	2. wr: Function writing a byte at given address of storage.
+	3. base: Address of first byte of the two image slots.
+
+Remarks: 
+	Storage is byte addressed, so that a file or mmap-ed region on
+	host, or any external memory, can be plugged in. It must hold 
+	2 * Checkpoint::size() bytes from base. rd and wr are only called
+	with interrupts enabled.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+void Checkpoint::setStorage(storageReadFcn rd, storageWriteFcn wr, uint16_t base){
+  ckptRead = rd;
+  ckptWrite = wr;
+  ckptBase = base;
+  ckptSlotKnown = false;
+}
+
+/******************************************************************
+Function: useEEPROM (Checkpoint)
+Parameters: 
+	1. base: EEPROM address of first byte of the two image slots.
+
+Remarks: 
+	Uses the internal EEPROM of AVR as storage. Keep 
+	2 * Checkpoint::size() bytes from base free for the images.
+	Bytes are written with eeprom_write_byte, hence a full save 
+	writes every byte and an incremental save only changed ones.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+void Checkpoint::useEEPROM(uint16_t base){
+  setStorage(eepromRead, eepromWrite, base);
+}
+
+/******************************************************************
+Function: size (Checkpoint)
+Parameters: None
+Returns:
+	Size of one checkpoint image (in bytes) of registered machines.
+	Storage holds two images.
+
+******************************************************************/
+uint16_t Checkpoint::size(){
+  uint16_t n = 6 + 2;                                     // header + crc
+  for (uint8_t i = 0; i < checkpointSM_head; i++){
+    n += 7 + 4 * (*arrCheckpointSM[i])._childState_head;
+  }
+  return n;
+}
+
+/******************************************************************
+Function: save (Checkpoint)
+Parameters: 
+	1. incremental: If true, only the bytes which differ from the 
+		image currently in the slot being overwritten are written 
+		(saves EEPROM wear and write time, as a checkpoint mostly 
+		changes few fields). As saves alternate between two slots, 
+		that is the image of two saves ago, not of the last one.
+		If false, every byte is written. Incremental mode gains 
+		nothing for a storage whose write function already skips 
+		unchanged bytes (useEEPROM writes unconditionally).
+Returns:
+	Number of bytes passed to the storage write function.
+
+Remarks: 
+	Serializes currState, tickCount, isTrnActive of each registered 
+	machine and exec_time of each of its states into the slot which
+	does not hold the newest valid image, with the next sequence 
+	number. Each field is read with interrupts disabled, but 
+	interrupts stay enabled while the (slow) storage is written.
+
+Warning: (issued if <Log.h> is defined)
+	None.
 
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+uint16_t Checkpoint::save(boolean incremental){
+  if (ckptWrite == NULL || ckptRead == NULL) {return 0;}
+  
+  if (!ckptSlotKnown) {findNewestSlot();}
+  uint8_t slot = (ckptSlot == 0) ? 1 : 0;                 // Never overwrite the newest valid image
+  uint16_t seq = ckptSeq + 1;
+  
+  ckptAddr = slotAddress(slot);
+  ckptCrc = 0xFFFF;
+  ckptWritten = 0;
+  ckptIncremental = incremental;
+  
+  putByte('T');
+  putByte('A');
+  putByte(CHECKPOINT_VERSION);
+  putByte((uint8_t)seq);
+  putByte((uint8_t)(seq >> 8));
+  putByte(checkpointSM_head);
+  
+  for (uint8_t i = 0; i < checkpointSM_head; i++){
+    SM* sm = arrCheckpointSM[i];
+    
+    noInterrupts();
+    State* cState = (*sm).currState;
+    uint8_t flags = ((*sm).isTrnActive ? CKPT_TRN_ACTIVE : 0);
+    if (cState != NULL && (*cState).inProgress) {flags |= CKPT_IN_PROGRESS;}
+    unsigned long count = (*sm).tickCount;
+    interrupts();
+    
+    uint8_t idx = CKPT_NO_STATE;
+    for (uint8_t j = 0; j < (*sm)._childState_head; j++){
+      if ((*sm).childStates[j] == cState) {idx = j;}
+    }
+    
+    putByte((*sm)._childState_head);
+    putByte(idx);
+    putByte(flags);
+    putLong(count);
+    
+    for (uint8_t j = 0; j < (*sm)._childState_head; j++){
+      noInterrupts();
+      unsigned long t = (*(*sm).childStates[j]).exec_time;
+      interrupts();
+      putLong(t);
+    }
+  }
+  
+  uint16_t crc = ckptCrc;
+  putByte((uint8_t)crc);
+  putByte((uint8_t)(crc >> 8));
+  
+  ckptSlot = slot;
+  ckptSeq = seq;
+  
+  return ckptWritten;
+}
+
+/******************************************************************
+Function: restore (Checkpoint)
+Parameters: None
+Returns:
+	true:  If a valid image was found and applied.
+	false: If storage is not set, or neither slot holds an image of 
+		this version, intact (CRC) and matching the registered 
+		machines. Machines are left untouched in this case.
+
+Remarks: 
+	Call after the machines are constructed and their states added,
+	and before TickTimer::startTicking(). The newest valid image is 
+	decoded with interrupts enabled, then applied with interrupts 
+	disabled. A state which was in progress when the image was saved
+	resumes its update from the beginning (resumable states restart 
+	from TA_BEGIN), while its exec_time keeps counting towards the 
+	deadlines.
+
+Warning: (issued if <Log.h> is defined)
+	None.
+
+Error: (issued if <Log.h> is defined)
+	None.
+
+******************************************************************/
+boolean Checkpoint::restore(){
+  if (ckptRead == NULL) {return false;}
+  
+  findNewestSlot();
+  if (ckptSlot == CKPT_NO_SLOT) {return false;}
+  
+  CheckpointSM image[MAX_CHECKPOINT_SM];
+  uint16_t seq;
+  if (!readSlot(ckptSlot, &seq, image)) {return false;}
+  
+  noInterrupts();
+  for (uint8_t i = 0; i < checkpointSM_head; i++){
+    SM* sm = arrCheckpointSM[i];
+    CheckpointSM* m = &image[i];
+    
+    (*sm).tickCount = (*m).tickCount;
+    (*sm).currState = ((*m).idx == CKPT_NO_STATE) ? NULL : (*sm).childStates[(*m).idx];
+    (*sm).isTrnActive = ((*m).flags & (CKPT_TRN_ACTIVE | CKPT_IN_PROGRESS)) != 0;
+    (*sm)._memoValid = false;
+    
+    for (uint8_t j = 0; j < (*sm)._childState_head; j++){
+      State* s = (*sm).childStates[j];
+      (*s).exec_time = (*m).exec_time[j];
+      (*s).inProgress = (((*m).flags & CKPT_IN_PROGRESS) && j == (*m).idx);
+      (*s)._lc = 0;
+    }
+  }
+  interrupts();
+  
+  return true;
+}
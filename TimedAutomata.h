@@ -35,9 +35,17 @@
 //        #define W003    3    // overwritten mySM
 //        #define W004    4    // addition after MAX_CHILD_STATE
 //        #define W005    5    // soft-deadline
+//        #define W006    6    // more than MAX_CHECKPOINT_SM machines
+//        #define W007    7    // rejected: ISR cost exceeds tick budget
+//        #define W008    8    // rejected: state cannot meet hard deadline
+//        #define W009    9    // more than MAX_SM_INPUTS inputs or MAX_INPUT_BYTES bytes
 //        
 //        #define E001    1    // hard deadline
 
+        // Uncomment following line to measure worst-case ISR duration (TickTimer::_isr_max_us).
+        
+//        #define TA_MEASURE_ISR
+
         
 
 //==========================================================================================================
@@ -49,6 +57,17 @@
         
 	#define  MAX_CALLBACK  10        // Maximum callbacks permitted (keep it small for smaller tick-times)
 	#define MAX_CHILD_STATE 5		 // Maximum child states per SM
+	#define MAX_SM_INPUTS 4			 // Maximum inputs declared per SM
+	#define MAX_INPUT_BYTES 8		 // Maximum total size (in bytes) of inputs per SM
+	#define MAX_CHECKPOINT_SM 4	 // Maximum machines included in a checkpoint image
+	#define CHECKPOINT_VERSION 1	 // Layout version of checkpoint image
+	#define ISR_BUDGET_PERCENT 80	 // Share of tick time which ISR is allowed to use (admission control)
+	
+	#define ADMIT_OK			0	 // Admitted
+	#define ADMIT_ISR_BUDGET	1	 // Rejected: ISR cost per tick would exceed its budget
+	#define ADMIT_DEADLINE		2	 // Rejected: update of a state cannot meet its hardDeadline
+	#define ADMIT_FULL			3	 // Rejected: no free slot
+	#define ADMIT_UNBOUNDED		4	 // Rejected: resumable state, but loop cost of SM is undeclared
 	
 	
 	#define  TICK_50US     50      
@@ -71,6 +90,21 @@
 	typedef void (*updateFcn)();
 	typedef void (*callback)();      	// Type definition for no-input, no-output function pointers
 	typedef State* (*transitionFcn)(State* cState);
+	typedef uint8_t (*resumableFcn)(State* s);	// Resumable update function. Returns TA_YIELDED or TA_DONE.
+	typedef uint8_t (*storageReadFcn)(uint16_t addr);				// Reads a byte of checkpoint storage
+	typedef void (*storageWriteFcn)(uint16_t addr, uint8_t value);	// Writes a byte of checkpoint storage
+	
+	
+	// Protothread-style macros for resumable update functions. Usage:
+	//     uint8_t myUpdate(State* s){ TA_BEGIN(s); ...; TA_YIELD(s); ...; TA_END(s); }
+	// Local variables are NOT preserved across TA_YIELD (declare them static).
+	// Do not use switch statements between TA_BEGIN and TA_END.
+	#define TA_YIELDED		0
+	#define TA_DONE			1
+	
+	#define TA_BEGIN(s)		switch ((s)->_lc) { case 0:
+	#define TA_YIELD(s)		do { (s)->_lc = __LINE__; return TA_YIELDED; case __LINE__: ; } while (0)
+	#define TA_END(s)		} (s)->_lc = 0; return TA_DONE
 	
 	
 	
@@ -81,12 +115,33 @@
 		extern unsigned long tickTime;                                // time between two ticks in microseconds
 		extern volatile unsigned char _tcnt_reload;                   // internal variable for timer2 configuration (reload count for tcnt)
 		extern volatile unsigned char _callback_array_head;           // pointer to current position of array of callbacks (internal)
+		extern volatile unsigned char _tick_counts;                   // timer counts per tick (internal)
+		extern volatile unsigned int _ticks_pending;                  // ticks spanned by the running timer interval (internal)
+		extern volatile boolean _tickless;                            // true, if tickless idle mode is enabled
+		extern unsigned long _callback_cost_us;                       // sum of declared worst-case costs of callbacks (internal)
+		extern volatile unsigned long _isr_max_us;                    // measured worst-case ISR duration (TA_MEASURE_ISR)
 
 
 		void configure(unsigned long tickTime_us);                    // Configuration function for tickTime
 		void registerCallback(callback fcn);                          // Register a new callback function
+		uint8_t registerCallback(callback fcn, unsigned long wcet_us);   // Register callback with worst-case cost. Returns ADMIT_*.
 		void startTicking();                                          // Starts the operation of timer
 		void stopTicking();                                           // Stops the operation of timer
+		void enableTickless();                                        // Skip ticks at which nothing is due (NO_HZ-like idle)
+		void disableTickless();                                       // Back to periodic ticking
+		unsigned int longestInterval();                               // Ticks spanned by longest tickless interval
+
+	}
+	
+	// namespace with report of last admission check (registerCallback, registerToTimer, addState)
+	namespace Admission{
+
+		extern uint8_t lastResult;                                    // ADMIT_* code
+		extern unsigned long lastDemand_us;                           // ISR cost per tick, or response time of state
+		extern unsigned long lastBound_us;                            // ISR budget, or hard deadline of state
+		extern State* lastState;                                      // State which missed its deadline (ADMIT_DEADLINE, ADMIT_UNBOUNDED)
+
+		uint8_t check();                                              // Re-checks registered SM with current declarations. Returns ADMIT_*.
 
 	}
 	
@@ -96,18 +151,27 @@
 			unsigned long softDeadline;            // Triggers warning
 			unsigned long hardDeadline;            // Triggers error
 			updateFcn myFcn;                       // State Update function pointer
+			resumableFcn myResFcn;                 // Resumable update function pointer (NULL if myFcn is used)
+			uint16_t _lc;                          // Resume point of myResFcn (internal, 0 = start)
 			volatile boolean inProgress = false;   // true, if state is in update mode
 			volatile unsigned long exec_time;      // Maintains the execution time
+			unsigned long wcet_us;                 // Worst-case cost of complete update in microseconds (0 = undeclared)
+			uint8_t wcet_slices;                   // Worst-case number of slices of resumable update
 		  
 		public:
 			State(updateFcn fcn);
 			State(updateFcn fcn, unsigned long hard_deadline_ticks);
 			State(updateFcn fcn, unsigned long hard_deadline_ticks, unsigned long soft_deadline_ticks); 
+			State(resumableFcn fcn);
+			State(resumableFcn fcn, unsigned long hard_deadline_ticks);
+			State(resumableFcn fcn, unsigned long hard_deadline_ticks, unsigned long soft_deadline_ticks); 
 
 			int8_t tick();                         // 0 = OK, -1: hard_deadline crossed, 1: soft_deadline crossed
 
-			inline void update() {if (inProgress) {myFcn();}}        // Executes the update function of state
-			inline void reset()  {exec_time = 0;}                    // Resets the run time of state
+			boolean update();                                        // Executes (a slice of) the update function. true, if done.
+			inline void reset()  {exec_time = 0; _lc = 0;}           // Resets the run time of state
+			inline void setWCET(unsigned long us) {wcet_us = us; wcet_slices = 1;}    // Declares worst-case cost of update (for admission control, before SM::addState)
+			inline void setWCET(unsigned long us, uint8_t slices) {wcet_us = us; wcet_slices = slices;}   // Same, for a resumable update of all its slices
 	};
 
 	class SM{
@@ -122,17 +186,52 @@
 
 			State* currState;									// Current state of machine
 			boolean isTrnActive;								// state variable: denotes whether the transition is enabled or not.
+			unsigned long tickCost_us;							// Worst-case cost of SM::tick in microseconds (0 = undeclared)
+			unsigned long loopCost_us;							// Worst-case cost of loop() between two step() of this SM (0 = undeclared)
+
+			const volatile void* _inputs[MAX_SM_INPUTS];		// declared inputs of transition function
+			uint8_t _inputSize[MAX_SM_INPUTS];					// size of each input
+			uint8_t _inputOffset[MAX_SM_INPUTS];				// offset of each input in snapshot
+			uint8_t _input_head, _input_bytes;					// current number of inputs, total size of inputs
+			uint8_t _snapshot[2][MAX_INPUT_BYTES];				// double-buffered snapshot of inputs
+			volatile uint8_t _snapFront;						// buffer holding the latest snapshot
+
+			State* _memoFrom;									// state from which transition was last evaluated
+			State* _memoNext;									// next state returned by that evaluation
+			boolean _memoValid;									// true, if _memoFrom/_memoNext hold an evaluation
+			unsigned long memoEvals, memoHits;					// transitions taken, transitions served from cache
 
 		public:
 			SM(transitionFcn gnv, unsigned long interval);			// Constructor. interval = tickInterval 
 																	// (MUST BE CONFIGURED AFTER TickTimer::configure)
-			void registerToTimer();									// Configure this machine as main machine. Registers callback to this SM.
+			uint8_t registerToTimer();								// Configure this machine as main machine. Registers callback to this SM. Returns ADMIT_*.
 			
 			inline void setStartState(State* s) {currState = s;}	// Set start state of machine.
-			void addState(State* s);								// Adds new state to SM.
+			uint8_t addState(State* s);								// Adds new state to SM. Returns ADMIT_*.
+			inline void setTickCost(unsigned long us) {tickCost_us = us;}	// Declares worst-case cost of tick (for admission control, before registerToTimer)
+			inline void setLoopCost(unsigned long us) {loopCost_us = us;}	// Declares worst-case cost of loop() between steps (for admission control, before addState)
 			void tick();											// Tick any running state and evaluates for error/warning
-			void step();											// Implements the transition if enabled.
+			void advance(unsigned long ticks);						// Catch up ticks elapsed since last timer interrupt (tickless mode)
+			unsigned long ticksToNextEvent();						// Number of ticks until this SM needs the next tick
+			void step();											// Runs a slice of current state and implements the transition once done.
+			void addInput(const volatile void* src, uint8_t size);	// Declares an input of transition function (latched by step() before the transition is evaluated)
+			inline void readInput(uint8_t i, void* dst) {memcpy(dst, &_snapshot[_snapFront][_inputOffset[i]], _inputSize[i]);}	// Copies latched value of i-th input to dst
+			void latch();											// Latches inputs into snapshot (internal)
+			State* nextState();										// Evaluates (or reuses) the transition (internal)
 			void reset();											// Resets each and every constituent states.
 	};
 	
+	// namespace with warm restart functionality: checkpoint/restore of runtime state of machines
+	namespace Checkpoint{
+
+		void registerMachine(SM* sm);                                 // Include a machine in checkpoint image (in order)
+		void setStorage(storageReadFcn rd, storageWriteFcn wr, uint16_t base);   // Pluggable storage (file, mmap, ...), 2 * size() bytes
+		void useEEPROM(uint16_t base);                                // Use AVR EEPROM as storage, starting at base
+		
+		uint16_t size();                                              // Size of checkpoint image in bytes
+		uint16_t save(boolean incremental);                           // Writes image to older slot. Returns number of bytes written.
+		boolean restore();                                            // Restores newest valid image. false, if none.
+
+	}
+	
 #endif
\ No newline at end of file
@@ -0,0 +1,146 @@
+// user-029: Admission control validated against simulated execution.
+//
+// Machine M (1 ms tick, SM interval 1 tick) alternates between an idle state of random
+// length and a work state with hardDeadline DEADLINE ticks. The work state is a blocking
+// update, or a resumable update in SLICES slices with LOOP_US of other loop() work between
+// them. Callbacks consume their declared cost in the ISR. For each configuration the
+// admission result of addState() is recorded, then the configuration is run anyway and
+// the largest exec_time at completion is compared with the deadline. The ISR duration is
+// measured with TA_MEASURE_ISR and compared with the declared ISR cost.
+// Finally, a cost raised after the state was admitted must not make a zero-cost callback
+// be dropped, and must be reported by Admission::check().
+
+#include <stdio.h>
+#include "TimedAutomata1.h"
+#include "host_sim.h"
+
+#define TICK_US      1000
+#define DEADLINE     10
+#define SLICES       4
+#define LOOP_US      600
+#define RUN_US       2000000UL
+
+static unsigned long workUs, callbackUs;
+
+static void idleUpdate()     {hostDelay(rand() % TICK_US);}
+static void workBlocking()   {hostDelay(workUs);}
+static uint8_t workResumable(State* s){
+  static uint8_t i;
+  TA_BEGIN(s);
+  for (i = 0; i < SLICES; i++){
+    hostDelay(workUs / SLICES);
+    TA_YIELD(s);
+  }
+  TA_END(s);
+}
+static void callbackWork()   {hostDelay(callbackUs);}
+static void callbackNone()   {}
+
+State idle(idleUpdate);
+State workB(workBlocking, DEADLINE), workR(workResumable, DEADLINE);
+State* work;
+
+static State* gnv(State* c)  {return (c == work) ? &idle : work;}
+SM machine(gnv, 1);
+
+struct Result { uint8_t admit; unsigned long bound, maxExec, isrMeasured, isrDeclared; };
+
+static Result run(boolean resumable, unsigned long wcet, unsigned long cb){
+  hostReset();
+  srand(1);
+  workUs = wcet;
+  callbackUs = cb;
+  work = resumable ? &workR : &workB;
+  
+  TickTimer::configure(TICK_US);
+  TickTimer::_callback_array_head = 0;
+  TickTimer::_callback_cost_us = 0;
+  TickTimer::_isr_max_us = 0;
+  if (cb > 0) {TickTimer::registerCallback(callbackWork, cb);}
+  
+  machine = SM(gnv, 1);
+  machine.setLoopCost(LOOP_US);
+  machine.addState(&idle);
+  machine.registerToTimer();
+  
+  if (resumable) {(*work).setWCET(wcet, SLICES);} else {(*work).setWCET(wcet);}
+  Result r;
+  r.admit = machine.addState(work);
+  r.bound = Admission::lastDemand_us;
+  if (r.admit != ADMIT_OK){                             // Run it anyway, undeclared
+    (*work).setWCET(0);
+    machine.addState(work);
+  }
+  machine.setStartState(&idle);
+  machine.reset();
+  (*work).inProgress = false;
+  TickTimer::startTicking();
+  
+  r.maxExec = 0;
+  while (micros() < RUN_US){
+    State* before = machine.currState;
+    machine.step();
+    if (before == work && machine.currState != work && (*work).exec_time > r.maxExec) {r.maxExec = (*work).exec_time;}
+    hostDelay(LOOP_US);                                 // rest of loop()
+  }
+  TickTimer::stopTicking();
+  
+  r.isrMeasured = TickTimer::_isr_max_us;
+  r.isrDeclared = TickTimer::_callback_cost_us;
+  return r;
+}
+
+// Declares a cost after addState, then registers an undeclared callback.
+static boolean lateDeclaration(){
+  hostReset();
+  TickTimer::configure(TICK_US);
+  TickTimer::_callback_array_head = 0;
+  TickTimer::_callback_cost_us = 0;
+  
+  machine = SM(gnv, 1);
+  workB.setWCET(0);
+  machine.addState(&workB);
+  machine.registerToTimer();
+  workB.setWCET(DEADLINE * TICK_US + 1000);             // Cannot meet its deadline anymore
+  
+  TickTimer::registerCallback(callbackNone);
+  boolean added = (TickTimer::_callback_array_head == 1);
+  uint8_t found = Admission::check();
+  workB.setWCET(0);
+  
+  printf("late declaration: zero-cost callback %s, Admission::check() = %u\n", added ? "added" : "dropped", found);
+  return added && found == ADMIT_DEADLINE && Admission::lastState == &workB;
+}
+
+int main(){
+  static const unsigned long callbacks[] = {0, 200, 400};
+  unsigned int admitted = 0, rejected = 0, missedAdmitted = 0, missedRejected = 0;
+  unsigned long worstIsrGap = 0;
+  
+  printf("tick %d us, hardDeadline %d ticks, resumable: %d slices with %d us loop() between\n", TICK_US, DEADLINE, SLICES, LOOP_US);
+  printf("%-10s %10s %10s %8s %12s %14s %10s\n", "update", "wcet(us)", "cb(us)", "admit", "bound R(us)", "max exec_time", "overrun");
+  
+  for (int kind = 0; kind < 2; kind++){
+    for (unsigned int c = 0; c < sizeof(callbacks) / sizeof(callbacks[0]); c++){
+      for (unsigned long wcet = 4000; wcet <= 11000; wcet += 1000){
+        Result r = run(kind == 1, wcet, callbacks[c]);
+        boolean overrun = r.maxExec > DEADLINE;
+        
+        printf("%-10s %10lu %10lu %8u %12lu %14lu %10s\n", kind ? "resumable" : "blocking", wcet, callbacks[c],
+               r.admit, r.bound, r.maxExec, overrun ? "yes" : "no");
+        
+        if (r.admit == ADMIT_OK) {admitted++; if (overrun) {missedAdmitted++;}}
+        else                     {rejected++; if (overrun) {missedRejected++;}}
+        if (r.isrMeasured > r.isrDeclared && r.isrMeasured - r.isrDeclared > worstIsrGap) {worstIsrGap = r.isrMeasured - r.isrDeclared;}
+      }
+    }
+  }
+  
+  printf("admitted %u (overrun %u), rejected %u (overrun %u), measured ISR above declared by at most %lu us\n",
+         admitted, missedAdmitted, rejected, missedRejected, worstIsrGap);
+  
+  // Checks: no admitted configuration overruns, and the measured ISR matches its declaration.
+  if (missedAdmitted != 0 || worstIsrGap != 0) {printf("FAIL\n"); return 1;}
+  if (!lateDeclaration()) {printf("FAIL\n"); return 1;}
+  return 0;
+}
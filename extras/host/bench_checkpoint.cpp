@@ -0,0 +1,159 @@
+// user-028: Checkpoint size and write time, and restore after a save cut by a brownout.
+//
+// Full and incremental saves are written to the simulated EEPROM (3.4 ms per physical byte
+// write, preempted by the 1 ms tick) from the same prior contents of both slots, after the
+// machines have run on since the older image. A full save is also written to a host file.
+// The brownout check cuts a save after every possible number of written bytes and requires
+// restore() to apply either the new or the previous image.
+
+#include <stdio.h>
+#include <time.h>
+#include "TimedAutomata1.h"
+#include "host_sim.h"
+
+#define TICK_US  1000
+
+static void work() {hostDelay(200);}
+static State* gnv(State* c) {return c;}
+
+State states[MAX_CHECKPOINT_SM][MAX_CHILD_STATE] = {
+  {State(work), State(work), State(work), State(work), State(work)},
+  {State(work), State(work), State(work), State(work), State(work)},
+  {State(work), State(work), State(work), State(work), State(work)},
+  {State(work), State(work), State(work), State(work), State(work)},
+};
+SM machines[MAX_CHECKPOINT_SM] = {SM(gnv, 1), SM(gnv, 2), SM(gnv, 3), SM(gnv, 4)};
+
+extern uint8_t checkpointSM_head;
+
+static void tick1() {machines[1].tick();}
+static void tick2() {machines[2].tick();}
+static void tick3() {machines[3].tick();}
+static const callback tickers[MAX_CHECKPOINT_SM] = {NULL, tick1, tick2, tick3};
+
+// Storage cut off after a number of writes (brownout).
+static uint8_t mem[256];
+static long writesLeft;
+static uint8_t memRead(uint16_t a)             {return mem[a];}
+static void memWrite(uint16_t a, uint8_t v)    {if (writesLeft > 0) {mem[a] = v; writesLeft--;}}
+
+// Host file storage.
+static FILE* file;
+static uint8_t fileRead(uint16_t a)            {fseek(file, a, SEEK_SET); int c = fgetc(file); return (c == EOF) ? 0xFF : c;}
+static void fileWrite(uint16_t a, uint8_t v)   {fseek(file, a, SEEK_SET); fputc(v, file); fflush(file);}
+
+static void setup(uint8_t nMachines, uint8_t nStates){
+  hostReset();
+  checkpointSM_head = 0;
+  TickTimer::_callback_array_head = 0;
+  TickTimer::_callback_cost_us = 0;
+  TickTimer::configure(TICK_US);
+  
+  for (uint8_t i = 0; i < nMachines; i++){
+    machines[i] = SM(gnv, i + 1);
+    for (uint8_t j = 0; j < nStates; j++) {machines[i].addState(&states[i][j]);}
+    machines[i].setStartState(&states[i][0]);
+    Checkpoint::registerMachine(&machines[i]);
+    if (i > 0) {TickTimer::registerCallback(tickers[i]);}
+  }
+  machines[0].registerToTimer();
+  TickTimer::startTicking();
+}
+
+static void runFor(unsigned long us){
+  unsigned long end = micros() + us;
+  while (micros() < end){
+    for (uint8_t i = 0; i < checkpointSM_head; i++) {machines[i].step();}
+    hostDelay(100);
+  }
+}
+
+static double hostMs(clock_t c) {return 1000.0 * c / CLOCKS_PER_SEC;}
+
+struct Save { unsigned long writes, us; uint8_t image[HOST_EEPROM_SIZE]; };
+
+// Saves from the given EEPROM contents; reports physical writes and simulated time.
+static void measure(const uint8_t* prior, boolean incremental, Save* r){
+  memcpy(hostEEPROM, prior, HOST_EEPROM_SIZE);
+  Checkpoint::useEEPROM(0);                             // Forget the slot written last
+  
+  unsigned long w = hostEepromWrites(), t = micros();
+  Checkpoint::save(incremental);
+  (*r).us = micros() - t;
+  (*r).writes = hostEepromWrites() - w;
+  memcpy((*r).image, hostEEPROM, HOST_EEPROM_SIZE);
+}
+
+int main(){
+  static const uint8_t configs[][2] = {{1, 2}, {1, 5}, {4, 5}};
+  static uint8_t prior[HOST_EEPROM_SIZE];
+  static Save full, incr;
+  int failed = 0;
+  
+  printf("%-12s %8s %14s %16s %14s %16s %16s\n", "machines x", "image", "EEPROM full", "EEPROM full", "EEPROM incr", "EEPROM incr", "file full");
+  printf("%-12s %8s %14s %16s %14s %16s %16s\n", "states", "(bytes)", "(writes)", "(ms, simulated)", "(writes)", "(ms, simulated)", "(ms, host)");
+  
+  for (unsigned int c = 0; c < sizeof(configs) / sizeof(configs[0]); c++){
+    setup(configs[c][0], configs[c][1]);
+    Checkpoint::useEEPROM(0);
+    runFor(50000);
+    Checkpoint::save(false);                            // Older image: overwritten next
+    runFor(20000);
+    Checkpoint::save(false);                            // Newer image
+    runFor(20000);
+    TickTimer::stopTicking();                           // Same runtime state for both modes
+    
+    memcpy(prior, hostEEPROM, HOST_EEPROM_SIZE);
+    measure(prior, false, &full);
+    measure(prior, true, &incr);
+    
+    file = tmpfile();
+    Checkpoint::setStorage(fileRead, fileWrite, 0);
+    clock_t h = clock();
+    for (int k = 0; k < 100; k++) {Checkpoint::save(false);}
+    double fileMs = hostMs(clock() - h) / 100;
+    fclose(file);
+    
+    printf("%u x %-8u %8u %14lu %16.1f %14lu %16.1f %16.4f\n", configs[c][0], configs[c][1], Checkpoint::size(),
+           full.writes, full.us / 1000.0, incr.writes, incr.us / 1000.0, fileMs);
+    
+    // Checks: both modes leave the same image; full writes every byte, incremental no more.
+    if (memcmp(full.image, incr.image, HOST_EEPROM_SIZE) != 0)  {printf("FAIL: images differ\n"); failed = 1;}
+    if (full.writes != Checkpoint::size())                      {printf("FAIL: full save\n"); failed = 1;}
+    if (incr.writes > full.writes)                              {printf("FAIL: incremental save\n"); failed = 1;}
+  }
+  
+  // Brownout: cut the save after every possible number of bytes.
+  setup(2, 3);
+  Checkpoint::setStorage(memRead, memWrite, 0);
+  memset(mem, 0xFF, sizeof(mem));
+  unsigned int cuts = 0, oldImage = 0;
+  
+  for (long cut = 0; cut <= Checkpoint::size(); cut++){
+    writesLeft = 1000;
+    runFor(3000);
+    machines[1].tickCount = 1000 + cut;                 // Marks the previous image
+    Checkpoint::save(false);
+    
+    runFor(1000);
+    machines[1].tickCount = 2000 + cut;                 // Marks the new image
+    writesLeft = cut;
+    Checkpoint::save(false);                            // Power lost after cut bytes
+    
+    machines[1].tickCount = 0;
+    machines[1].currState = NULL;
+    boolean restored = Checkpoint::restore();
+    unsigned long expected = (cut < Checkpoint::size()) ? 1000 + cut : 2000 + cut;
+    
+    if (!restored || machines[1].currState == NULL || machines[1].tickCount != expected){
+      printf("FAIL: cut at byte %ld restored %lu, expected %lu\n", cut, machines[1].tickCount, expected);
+      failed = 1;
+    }
+    if (expected < 2000) {oldImage++;}
+    cuts++;
+  }
+  printf("brownout: %u saves cut after 0..%u bytes, %u restored the previous image, %u the new one: %s\n",
+         cuts, Checkpoint::size(), oldImage, cuts - oldImage, failed ? "FAIL" : "ok");
+  
+  return failed;
+}
@@ -0,0 +1,163 @@
+// user-030: Hit rate and step cost of memoized transitions.
+//
+// Two machines run the same transition function over a sensor reading and a mode flag.
+// "plain" reads the globals directly (no declared inputs, gnv runs on every step); "memo"
+// declares them with addInput and reads the latched snapshot with readInput. The inputs
+// change every CHANGE steps. Step cost is host time per tick()+step() pair.
+// Both machines are also run in lockstep and must be in the same state after every step,
+// including a pair whose update writes a declared input (a counter, leaving A at 3).
+
+#include <stdio.h>
+#include <time.h>
+#include "TimedAutomata1.h"
+#include "host_sim.h"
+
+#define STEPS        200000UL
+#define GNV_WORK     200                                // iterations of arithmetic in gnv
+
+volatile int16_t sensor;
+volatile uint8_t mode;
+volatile uint32_t sink;
+unsigned long gnvCalls;
+
+static void noop() {}
+State low(noop), high(noop);
+
+// Some filtering work, so that skipping gnv is measurable.
+static State* decide(State* c, int16_t v, uint8_t m){
+  uint32_t acc = v;
+  for (uint16_t k = 0; k < GNV_WORK; k++) {acc = acc * 1103515245UL + 12345UL + m;}
+  sink = acc;
+  gnvCalls++;
+  int16_t threshold = (c == &high) ? 90 : 110;          // hysteresis
+  return (v > threshold || m) ? &high : &low;
+}
+
+static State* gnvPlain(State* c) {return decide(c, sensor, mode);}
+SM plain(gnvPlain, 1);
+
+SM memo(NULL, 1);
+static State* gnvMemo(State* c){
+  int16_t v;
+  uint8_t m;
+  memo.readInput(0, &v);
+  memo.readInput(1, &m);
+  return decide(c, v, m);
+}
+
+// Update writes a declared input: A counts its activations, B clears the count.
+volatile uint8_t countPlain, countMemo;
+static void countUpPlain()  {countPlain++;}
+static void clearPlain()    {countPlain = 0;}
+static void countUpMemo()   {countMemo++;}
+static void clearMemo()     {countMemo = 0;}
+State aPlain(countUpPlain), bPlain(clearPlain), aMemo(countUpMemo), bMemo(clearMemo);
+
+static State* gnvCountPlain(State* c) {return (c == &aPlain && countPlain >= 3) ? &bPlain : &aPlain;}
+SM countingPlain(gnvCountPlain, 1);
+
+SM countingMemo(NULL, 1);
+static State* gnvCountMemo(State* c){
+  uint8_t n;
+  countingMemo.readInput(0, &n);
+  return (c == &aMemo && n >= 3) ? &bMemo : &aMemo;
+}
+
+static int stateIndex(SM& m){
+  for (uint8_t i = 0; i < m._childState_head; i++) {if (m.childStates[i] == m.currState) {return i;}}
+  return -1;
+}
+
+// Steps both machines alternately; returns the first step after which their states differ (0 = none).
+static unsigned long lockstep(SM& a, SM& b, unsigned long change, unsigned long steps){
+  sensor = 0;
+  mode = 0;
+  a.reset();
+  b.reset();
+  
+  for (unsigned long i = 0; i < steps; i++){
+    if (change != 0 && i % change == 0) {sensor = (sensor == 50) ? 150 : 50;}
+    a.tick();
+    a.step();
+    b.tick();
+    b.step();
+    if (stateIndex(a) != stateIndex(b)) {return i + 1;}
+  }
+  return 0;
+}
+
+static double nowNs(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static double run(SM& m, unsigned long change, unsigned long* calls){
+  sensor = 0;
+  mode = 0;
+  gnvCalls = 0;
+  m.setStartState(&low);
+  
+  double start = nowNs();
+  for (unsigned long i = 0; i < STEPS; i++){
+    if (i % change == 0) {sensor = (sensor == 50) ? 150 : 50;}
+    m.tick();
+    m.step();
+  }
+  double ns = (nowNs() - start) / STEPS;
+  
+  *calls = gnvCalls;
+  return ns;
+}
+
+int main(){
+  static const unsigned long changes[] = {1, 10, 100, 1000};
+  int failed = 0;
+  
+  hostReset();
+  plain.addState(&low);
+  plain.addState(&high);
+  memo = SM(gnvMemo, 1);
+  memo.addState(&low);
+  memo.addState(&high);
+  memo.addInput(&sensor, sizeof(sensor));
+  memo.addInput(&mode, sizeof(mode));
+  countingPlain.addState(&aPlain);
+  countingPlain.addState(&bPlain);
+  countingPlain.setStartState(&aPlain);
+  countingMemo = SM(gnvCountMemo, 1);
+  countingMemo.addState(&aMemo);
+  countingMemo.addState(&bMemo);
+  countingMemo.setStartState(&aMemo);
+  countingMemo.addInput(&countMemo, sizeof(countMemo));
+  
+  printf("%lu steps, gnv with %d iterations of work, inputs change every N steps\n", STEPS, GNV_WORK);
+  printf("%-8s %12s %12s %10s %16s %16s %10s\n", "N", "gnv plain", "gnv memo", "hit rate", "plain (ns/step)", "memo (ns/step)", "saved");
+  
+  for (unsigned int c = 0; c < sizeof(changes) / sizeof(changes[0]); c++){
+    unsigned long plainCalls, memoCalls;
+    memo.memoEvals = memo.memoHits = 0;
+    
+    double plainNs = run(plain, changes[c], &plainCalls);
+    double memoNs = run(memo, changes[c], &memoCalls);
+    double hitRate = 100.0 * memo.memoHits / memo.memoEvals;
+    
+    printf("%-8lu %12lu %12lu %9.1f%% %16.1f %16.1f %9.1f%%\n", changes[c], plainCalls, memoCalls, hitRate,
+           plainNs, memoNs, 100.0 * (plainNs - memoNs) / plainNs);
+    
+    // Checks: memoized machine follows the same states at every step, and skips gnv when inputs are steady.
+    plain.setStartState(&low);
+    memo.setStartState(&low);
+    unsigned long differ = lockstep(plain, memo, changes[c], 10000);
+    if (differ != 0)                                  {printf("FAIL: states differ after step %lu\n", differ); failed = 1;}
+    if (changes[c] >= 10 && memoCalls >= plainCalls)  {printf("FAIL: no calls saved\n"); failed = 1;}
+  }
+  
+  countPlain = countMemo = 0;
+  countingMemo.memoEvals = countingMemo.memoHits = 0;
+  unsigned long differ = lockstep(countingPlain, countingMemo, 0, 10000);
+  printf("update writes input (count, leave A at 3): states %s, hit rate %.1f%%\n",
+         differ ? "differ" : "equal at every step", 100.0 * countingMemo.memoHits / countingMemo.memoEvals);
+  if (differ != 0) {printf("FAIL: states differ after step %lu\n", differ); failed = 1;}
+  return failed;
+}
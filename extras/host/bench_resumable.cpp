@@ -0,0 +1,113 @@
+// user-026: Mixed long and short states, blocking vs resumable update of the long state.
+//
+// Machine L has a state whose update costs LONG_US of CPU time; machine S toggles between two
+// short states on every tick. Both are stepped from the same loop(). With a blocking updateFcn,
+// one step() of L takes LONG_US; with a resumable update split into SLICE_US slices, the longest
+// step() drops to about one slice and S keeps transitioning while L works.
+
+#include <stdio.h>
+#include "TimedAutomata1.h"
+#include "host_sim.h"
+
+#define TICK_US      1000
+#define LONG_US      20000
+#define SLICE_US     1000
+#define SHORT_US     100
+#define LOOP_US      10
+#define RUN_US       1000000UL
+
+static boolean resumable;
+static unsigned long sTransitions, lastS, maxSGap;
+
+static void longBlocking()   {hostDelay(LONG_US);}
+static uint8_t longResumable(State* s){
+  static unsigned long done;
+  TA_BEGIN(s);
+  for (done = 0; done < LONG_US; done += SLICE_US){
+    hostDelay(SLICE_US);
+    TA_YIELD(s);
+  }
+  TA_END(s);
+}
+static void shortUpdate()    {hostDelay(SHORT_US);}
+
+State longB(longBlocking), longR(longResumable), idle(shortUpdate);
+State shortA(shortUpdate), shortB(shortUpdate);
+
+static State* gnvL(State* c)  {return (c == &idle) ? (resumable ? &longR : &longB) : &idle;}
+static State* gnvS(State* c){
+  unsigned long t = micros();
+  if (sTransitions > 0 && t - lastS > maxSGap) {maxSGap = t - lastS;}
+  lastS = t;
+  sTransitions++;
+  return (c == &shortA) ? &shortB : &shortA;
+}
+
+SM machineL(gnvL, 1), machineS(gnvS, 1);
+static void tickS()  {machineS.tick();}
+
+struct Result { unsigned long maxStep, sTrn, sGap, lRuns, lExec; };
+
+static Result run(boolean useResumable){
+  hostReset();
+  resumable = useResumable;
+  sTransitions = lastS = maxSGap = 0;
+  
+  machineL = SM(gnvL, 1);
+  machineS = SM(gnvS, 1);
+  machineL.addState(&idle);
+  machineL.addState(resumable ? &longR : &longB);
+  machineL.setStartState(&idle);
+  machineS.addState(&shortA);
+  machineS.addState(&shortB);
+  machineS.setStartState(&shortA);
+  
+  TickTimer::_callback_array_head = 0;
+  TickTimer::_callback_cost_us = 0;
+  TickTimer::configure(TICK_US);
+  TickTimer::registerCallback(tickS);
+  machineL.registerToTimer();
+  TickTimer::startTicking();
+  
+  Result r = {0, 0, 0, 0, 0};
+  State* longState = resumable ? &longR : &longB;
+  
+  while (micros() < RUN_US){
+    State* before = machineL.currState;
+    unsigned long t = micros();
+    machineL.step();
+    t = micros() - t;
+    if (t > r.maxStep) {r.maxStep = t;}
+    if (before == longState && machineL.currState != longState){
+      r.lRuns++;
+      r.lExec = (*longState).exec_time;
+    }
+    
+    t = micros();
+    machineS.step();
+    t = micros() - t;
+    if (t > r.maxStep) {r.maxStep = t;}
+    
+    hostDelay(LOOP_US);
+  }
+  
+  TickTimer::stopTicking();
+  r.sTrn = sTransitions;
+  r.sGap = maxSGap;
+  return r;
+}
+
+int main(){
+  Result b = run(false), p = run(true);
+  
+  printf("tick %u us, long state %u us (slices of %u us), short state %u us, %lu ms simulated\n",
+         TICK_US, LONG_US, SLICE_US, SHORT_US, RUN_US / 1000);
+  printf("%-10s %14s %14s %18s %12s %20s\n", "update", "max step(us)", "S trans/s", "max S gap(us)", "L runs", "L exec_time(ticks)");
+  printf("%-10s %14lu %14lu %18lu %12lu %20lu\n", "blocking",  b.maxStep, b.sTrn, b.sGap, b.lRuns, b.lExec);
+  printf("%-10s %14lu %14lu %18lu %12lu %20lu\n", "resumable", p.maxStep, p.sTrn, p.sGap, p.lRuns, p.lExec);
+  
+  // Checks: slicing bounds step latency by a slice, and exec_time spans all slices.
+  if (p.maxStep >= b.maxStep || p.maxStep > 2 * SLICE_US) {printf("FAIL: step latency\n"); return 1;}
+  if (p.lExec < LONG_US / TICK_US)                         {printf("FAIL: exec_time\n"); return 1;}
+  return 0;
+}
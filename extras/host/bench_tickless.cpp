@@ -0,0 +1,83 @@
+// user-027: Interrupts per second and idle CPU, periodic vs tickless ticking.
+//
+// One SM whose state is idle (cheap update) checks for transitions every SM_INTERVAL_MS.
+// For each tick size the same simulated second is run with periodic and with tickless
+// ticking. ISR entry/exit plus SM::tick is modelled as ISR_COST_US per interrupt; idle CPU
+// is the share of time not spent in the ISR. Transitions are counted in runs with a zero ISR
+// cost, as the periodic ISR reloads TCNT2 late and drifts by its own cost on every tick.
+
+#include <stdio.h>
+#include "TimedAutomata1.h"
+#include "host_sim.h"
+
+#define SM_INTERVAL_MS  20
+#define ISR_COST_US     6
+#define RUN_US          1000000UL
+
+static unsigned long transitions;
+
+static void idleUpdate() {}
+State idle(idleUpdate);
+static State* gnv(State* c) {transitions++; return c;}
+SM machine(gnv, 1);
+
+struct Result { unsigned long irq, trn, maxGap; double idleCpu; };
+
+static Result run(unsigned long tick_us, boolean tickless, unsigned long isrCost_us, unsigned long interval){
+  hostReset();
+  hostIsrOverheadUs = isrCost_us;
+  transitions = 0;
+  
+  TickTimer::configure(tick_us);
+  machine = SM(gnv, interval);
+  machine.addState(&idle);
+  machine.setStartState(&idle);
+  machine.registerToTimer();
+  if (tickless) {TickTimer::enableTickless();} else {TickTimer::disableTickless();}
+  TickTimer::startTicking();
+  
+  while (micros() < RUN_US){
+    machine.step();
+    hostDelay(50);                                      // rest of loop()
+  }
+  TickTimer::stopTicking();
+  
+  Result r;
+  r.irq = hostInterrupts();
+  r.trn = transitions;
+  r.maxGap = hostMaxIrqGapUs();
+  r.idleCpu = 100.0 * (1.0 - (double)hostIsrCycles() / (double)hostCycles());
+  return r;
+}
+
+int main(){
+  static const unsigned long ticks[] = {TICK_50US, TICK_100US, TICK_200US, TICK_500US, TICK_1MS, TICK_2MS, TICK_4MS};
+  int failed = 0;
+  
+  printf("SM interval %d ms (in nominal ticks), modelled ISR cost %d us, %lu ms simulated\n", SM_INTERVAL_MS, ISR_COST_US, RUN_US / 1000);
+  printf("%-8s %10s %10s %10s %10s %10s %8s %8s %10s %14s\n", "tick", "real tick", "irq/s", "irq/s", "idle CPU %", "idle CPU %",
+         "trans", "trans", "longest", "longest");
+  printf("%-8s %10s %10s %10s %10s %10s %8s %8s %10s %14s\n", "(us)", "(us)", "periodic", "tickless", "periodic", "tickless",
+         "periodic", "tickless", "(ticks)", "(us, measured)");
+  
+  for (unsigned int i = 0; i < sizeof(ticks) / sizeof(ticks[0]); i++){
+    unsigned long interval = SM_INTERVAL_MS * 1000UL / ticks[i];
+    Result p = run(ticks[i], false, ISR_COST_US, interval), t = run(ticks[i], true, ISR_COST_US, interval);
+    Result pIdeal = run(ticks[i], false, 0, interval);
+    p.trn = pIdeal.trn;
+    t.trn = run(ticks[i], true, 0, interval).trn;
+    
+    unsigned long realTick = pIdeal.maxGap;                              // Periodic interrupts, no ISR cost
+    unsigned long longest = run(ticks[i], true, 0, 1000000UL).maxGap;    // SM never due: longest intervals only
+    unsigned int longestTicks = TickTimer::longestInterval();
+    
+    printf("%-8lu %10lu %10lu %10lu %10.2f %10.2f %8lu %8lu %10u %14lu\n", ticks[i], realTick, p.irq, t.irq, p.idleCpu, t.idleCpu,
+           p.trn, t.trn, longestTicks, longest);
+    
+    // Checks: fewer interrupts, the same transitions, and the longest interval as reported.
+    if (t.irq >= p.irq)                               {printf("FAIL: no fewer interrupts\n"); failed = 1;}
+    if (t.trn + 1 < p.trn || t.trn > p.trn + 1)       {printf("FAIL: transitions differ\n"); failed = 1;}
+    if (longest != longestTicks * realTick)           {printf("FAIL: longest interval\n"); failed = 1;}
+  }
+  return failed;
+}
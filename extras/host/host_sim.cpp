@@ -0,0 +1,102 @@
+#include "Arduino.h"
+#include <avr/eeprom.h>
+#include "host_sim.h"
+
+extern "C" void TIMER2_OVF_vect();
+
+static void timerWritten();
+
+HostReg8 TCCR2A = {0, NULL};
+HostReg8 TCCR2B = {0, timerWritten};
+HostReg8 TCNT2  = {0, timerWritten};
+HostReg8 TIMSK2 = {0, timerWritten};
+
+uint8_t hostEEPROM[HOST_EEPROM_SIZE];
+unsigned long hostIsrOverheadUs = 0;
+
+static unsigned long long now = 0;					// cycles
+static unsigned long long nextOvf = 0;				// cycles; 0 = timer not running
+static boolean inIsr = false, irqEnabled = true;
+static unsigned long interruptCount = 0, eepromWriteCount = 0;
+static unsigned long long isrCycles = 0;
+static unsigned long long lastIrq = 0, maxIrqGap = 0;
+
+static const unsigned int prescaler[8] = {0, 1, 8, 32, 64, 128, 256, 1024};   // Timer2 CS2[2:0]
+
+// Recomputes the next overflow from the counter value and prescaler just written.
+static void timerWritten(){
+  unsigned int p = prescaler[TCCR2B.v & 0x07];
+  if (p == 0 || !(TIMSK2.v & (1<<TOIE2))) {nextOvf = 0; return;}
+  nextOvf = now + (unsigned long long)(256 - TCNT2.v) * p;
+}
+
+static void raise(){
+  unsigned long long start = now;
+  
+  inIsr = true;
+  nextOvf = 0;										// ISR rearms the timer by writing TCNT2
+  if (interruptCount > 0 && now - lastIrq > maxIrqGap) {maxIrqGap = now - lastIrq;}
+  lastIrq = now;
+  interruptCount++;
+  now += (unsigned long long)hostIsrOverheadUs * (HOST_F_CPU / 1000000UL);
+  TIMER2_OVF_vect();
+  inIsr = false;
+  
+  isrCycles += now - start;
+}
+
+void hostDelay(unsigned long us){
+  unsigned long long end = now + (unsigned long long)us * (HOST_F_CPU / 1000000UL);
+  
+  if (inIsr) {now = end; return;}
+  
+  while (irqEnabled && nextOvf != 0 && nextOvf <= end){
+    now = nextOvf;
+    unsigned long long before = now;
+    raise();
+    end += now - before;							// Preempted: interrupted code finishes later
+  }
+  now = end;
+}
+
+void hostReset(){
+  now = 0;
+  nextOvf = 0;
+  inIsr = false;
+  irqEnabled = true;
+  interruptCount = 0;
+  eepromWriteCount = 0;
+  isrCycles = 0;
+  lastIrq = maxIrqGap = 0;
+  hostIsrOverheadUs = 0;
+  TCCR2A.v = TCCR2B.v = TCNT2.v = TIMSK2.v = 0;
+  memset(hostEEPROM, 0xFF, sizeof(hostEEPROM));		// Erased EEPROM reads 0xFF
+}
+
+unsigned long long hostCycles()      {return now;}
+unsigned long hostInterrupts()       {return interruptCount;}
+unsigned long long hostIsrCycles()   {return isrCycles;}
+unsigned long hostEepromWrites()     {return eepromWriteCount;}
+unsigned long hostMaxIrqGapUs()      {return (unsigned long)(maxIrqGap / (HOST_F_CPU / 1000000UL));}
+
+void noInterrupts()  {irqEnabled = false;}
+void interrupts()    {irqEnabled = true;}
+unsigned long micros() {return (unsigned long)(now / (HOST_F_CPU / 1000000UL));}
+
+uint8_t eeprom_read_byte(const uint8_t* addr){
+  return hostEEPROM[(uintptr_t)addr % HOST_EEPROM_SIZE];
+}
+
+void eeprom_write_byte(uint8_t* addr, uint8_t value){
+  hostDelay(HOST_EEPROM_WRITE_US);
+  hostEEPROM[(uintptr_t)addr % HOST_EEPROM_SIZE] = value;
+  eepromWriteCount++;
+}
+
+void eeprom_update_byte(uint8_t* addr, uint8_t value){
+  uintptr_t a = (uintptr_t)addr % HOST_EEPROM_SIZE;
+  if (hostEEPROM[a] == value) {return;}				// eeprom_update_byte skips unchanged bytes
+  hostDelay(HOST_EEPROM_WRITE_US);
+  hostEEPROM[a] = value;
+  eepromWriteCount++;
+}
@@ -0,0 +1,31 @@
+/************************************************************************************************************
+* Host simulation of an ATmega328 @ 16 MHz for TimedAutomata benchmarks.
+*
+* Time is simulated: it advances only through hostDelay(), which models code consuming CPU time.
+* Timer2 overflows are raised from the values written to TCCR2B/TCNT2/TIMSK2 and preempt the
+* running (non-ISR) code, so ISR time stretches the wall-clock time of the interrupted code.
+***********************************************************************************************************/
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+	#include <stdint.h>
+
+	#define HOST_F_CPU			16000000UL
+	#define HOST_EEPROM_SIZE	1024
+	#define HOST_EEPROM_WRITE_US 3400				// ATmega328P EEPROM erase+write time (datasheet: 3.3 ms)
+
+	extern uint8_t hostEEPROM[HOST_EEPROM_SIZE];
+
+	extern unsigned long hostIsrOverheadUs;			// modelled cost of ISR entry/exit (default 0)
+
+	void hostReset();								// Resets time, counters, timer and EEPROM
+	void hostDelay(unsigned long us);				// Consumes us of CPU time in current context
+	unsigned long long hostCycles();				// Simulated time in CPU cycles
+
+	unsigned long hostInterrupts();					// Timer2 interrupts raised so far
+	unsigned long long hostIsrCycles();				// Cycles spent inside the ISR
+	unsigned long hostEepromWrites();				// EEPROM bytes physically written so far
+	unsigned long hostMaxIrqGapUs();				// Longest time between two Timer2 interrupts
+
+#endif
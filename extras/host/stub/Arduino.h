@@ -0,0 +1,38 @@
+// Minimal Arduino.h for building TimedAutomata on a host (see extras/host/Makefile).
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+	#include <stdint.h>
+	#include <stddef.h>
+	#include <stdlib.h>
+	#include <string.h>
+
+	typedef bool boolean;
+	typedef uint8_t byte;
+
+	// Timer2 registers. Writes are observed by the simulated timer (host_sim.cpp).
+	struct HostReg8{
+		uint8_t v;
+		void (*onWrite)();
+
+		HostReg8& operator=(uint8_t x) {v = x; if (onWrite) {onWrite();} return *this;}
+		HostReg8& operator&=(uint8_t x) {return *this = (uint8_t)(v & x);}
+		HostReg8& operator|=(uint8_t x) {return *this = (uint8_t)(v | x);}
+		operator uint8_t() const {return v;}
+	};
+
+	extern HostReg8 TCCR2A, TCCR2B, TCNT2, TIMSK2;
+
+	#define WGM21	1
+	#define CS20	0
+	#define CS21	1
+	#define CS22	2
+	#define TOIE2	0
+
+	void noInterrupts();
+	void interrupts();
+	unsigned long micros();
+
+	#define ISR(vector)	extern "C" void vector()
+
+#endif
@@ -0,0 +1,2 @@
+// The library includes its header as "TimedAutomata1.h".
+#include "../../../TimedAutomata.h"
@@ -0,0 +1,11 @@
+// Host stub: EEPROM simulated by host_sim.cpp.
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+	#include <stdint.h>
+
+	uint8_t eeprom_read_byte(const uint8_t* addr);
+	void eeprom_write_byte(uint8_t* addr, uint8_t value);
+	void eeprom_update_byte(uint8_t* addr, uint8_t value);
+
+#endif
@@ -0,0 +1 @@
+// Host stub: interrupt control lives in Arduino.h.